@@ -0,0 +1,108 @@
+#include "../LineBalancer/InstanceGenerator.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+void usage()
+{
+	std::cerr << "Usage: InstanceGenerator <output file> [options]\n"
+		<< "  --binary           write the binary format instead of text\n"
+		<< "  --seed N           random seed\n"
+		<< "  --stations N       planted station count, optimal if leeway is 0\n"
+		<< "  --capacity N       bin capacity (cycle time)\n"
+		<< "  --leeway P         percent of every planted station left empty\n"
+		<< "  --density P        probability of a task having two successors\n"
+		<< "  --span N           successors are at most N tasks further, 0 - unbounded\n";
+}
+
+/**
+Parses the whole of value as a number in [min, max], or [min, max) if maxExcluded
+*/
+template<typename T>
+bool parse(const char* value, T min, T max, bool maxExcluded, T& result)
+{
+	char* end;
+	errno = 0;
+	double x = std::is_integral<T>::value ? double(std::strtoll(value, &end, 10)) : std::strtod(value, &end);
+	if (end == value || *end != '\0' || errno == ERANGE || x < min || x > max || (maxExcluded && x == max))
+		return false;
+	result = T(x);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+
+	InstanceGenerator::Parameters parameters;
+	bool binary = false;
+	for (int i = 2; i < argc; ++i)
+	{
+		if (!std::strcmp(argv[i], "--binary")) { binary = true; continue; }
+		if (i + 1 >= argc) { usage(); return 1; }
+		const char* value = argv[++i];
+		const int maxInt = std::numeric_limits<int>::max();
+		bool valid;
+		if (!std::strcmp(argv[i - 1], "--seed"))
+		{
+			char* end;
+			errno = 0;
+			parameters.seed = std::strtoull(value, &end, 10);
+			valid = end != value && *end == '\0' && errno != ERANGE && *value != '-';
+		}
+		else if (!std::strcmp(argv[i - 1], "--stations"))	valid = parse(value, 1, maxInt, false, parameters.stations);
+		else if (!std::strcmp(argv[i - 1], "--capacity"))	valid = parse(value, 1, maxInt, false, parameters.binCapacity);
+		else if (!std::strcmp(argv[i - 1], "--leeway"))		valid = parse(value, 0.0, 100.0, true, parameters.leeway);
+		else if (!std::strcmp(argv[i - 1], "--density"))	valid = parse(value, 0.0, 1.0, false, parameters.secondEdgeRate);
+		else if (!std::strcmp(argv[i - 1], "--span"))		valid = parse(value, 0, maxInt, false, parameters.maxEdgeSpan);
+		else valid = false;
+		if (!valid)
+		{
+			std::cerr << "Invalid option " << argv[i - 1] << " " << value << "\n";
+			usage();
+			return 1;
+		}
+	}
+
+	if (int(parameters.binCapacity * (1.0 - parameters.leeway / 100.0)) < 1)
+	{
+		std::cerr << "Leeway leaves no room for tasks\n";
+		usage();
+		return 1;
+	}
+
+	std::ofstream out(argv[1], binary ? std::ios::binary : std::ios::out);
+	if (!out)
+	{
+		std::cerr << "Cannot open " << argv[1] << "\n";
+		return 1;
+	}
+
+	int tasks;
+	long long edges;
+	InstanceGenerator generator(parameters);
+	if (binary)
+	{
+		InstanceGenerator::BinarySink sink(out);
+		generator.generate(sink, tasks, edges);
+	}
+	else
+	{
+		InstanceGenerator::TextSink sink(out);
+		generator.generate(sink, tasks, edges);
+	}
+
+	std::cerr << "Tasks: " << tasks << "\n"
+		<< "Precedence edges: " << edges << "\n"
+		<< "Planted stations: " << parameters.stations << (parameters.leeway > 0 ? "\n" : " (optimal)\n");
+	return out ? 0 : 1;
+}
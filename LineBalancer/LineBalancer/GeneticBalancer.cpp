@@ -2,16 +2,28 @@
 
 #include <algorithm>
 #include <numeric>
+#include <queue>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <iomanip>
+#include <cstdio>
 #include <ctime>
+#include <fstream>
+#include <limits>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
 
-GeneticBalancer::PrecedenceGraph::PrecedenceGraph(const std::vector<std::pair<int, int>>& edges)
+/**
+Graph over max(nodes, highest edge endpoint + 1) nodes
+*/
+GeneticBalancer::PrecedenceGraph::PrecedenceGraph(const std::vector<std::pair<int, int>>& edges, int nodes)
 {
 	std::cout << "Building precedence matrix...";
-	int n = -1;
+	int n = nodes - 1;
 	for (auto& e : edges)
 	{
 		if (n < e.first) n = e.first;
@@ -21,9 +33,11 @@ GeneticBalancer::PrecedenceGraph::PrecedenceGraph(const std::vector<std::pair<in
 
 	longestPath.resize(n);
 	for (auto& v : longestPath) v.resize(n);
+	successors.resize(n);
 
 	for (auto& e : edges)
 	{
+		successors[e.first].push_back(e.second);
 		int u = e.first, v = e.second;
 		if (u > v) std::swap(u, v);
 		longestPath[u][v] = 1;
@@ -48,32 +62,232 @@ GeneticBalancer::PrecedenceGraph::PrecedenceGraph(const std::vector<std::pair<in
 	}*/
 }
 
-GeneticBalancer::Chromosome GeneticBalancer::randomChromosome()
+/**
+Orders workstations so that every precedence edge goes forward along the line
+Strongly connected components of the workstation graph are found with Tarjan's algorithm and
+placed in topological order, O(V+E) in tasks and precedence edges
+Only stations on a common cycle cannot be ordered: inside a component the station with the fewest
+unplaced predecessor edges goes next (greedy feedback arc set), O(E log V) in that component's edges
+Edges that still go backwards (always inside a component) are reported in violations
+*/
+bool GeneticBalancer::PrecedenceGraph::sequenceWorkstations(std::vector<std::vector<int>>& workstations, std::vector<std::pair<int, int>>& violations) const
 {
-	Chromosome result(*this);
-	result.genes.push_back({});
+	violations.clear();
+	int n = workstations.size();
+
+	std::vector<int> stationOf(successors.size(), -1);
+	for (int i = 0; i < n; ++i)
+		for (auto& item : workstations[i])
+			if (item < stationOf.size())
+				stationOf[item] = i;
 
-	std::vector<int> itemsIndexes(items.size());
-	for (int i = 0; i < itemsIndexes.size(); ++i)
-		itemsIndexes[i] = i;
-	std::random_shuffle(itemsIndexes.begin(), itemsIndexes.end());
-	int currentBin = 0, currentFill = 0;
-	for (int i = 0; i < itemsIndexes.size(); )
+	///build workstation graph
+	std::vector<std::vector<int>> stationSuccessors(n);
+	for (int u = 0; u < successors.size(); ++u)
+		for (auto& v : successors[u])
+		{
+			int su = stationOf[u], sv = stationOf[v];
+			if (su == -1 || sv == -1 || su == sv) continue;
+			stationSuccessors[su].push_back(sv);
+		}
+
+	///Tarjan's strongly connected components, iterative
+	///components are completed sinks first, so the reversed completion order is topological
+	std::vector<int> index(n, -1), low(n), component(n), componentEnds, stack, reversedOrder;
+	std::vector<bool> onStack(n);
+	std::vector<std::pair<int, int>> callStack; //station, next successor to visit
+	int counter = 0;
+	reversedOrder.reserve(n);
+	for (int s = 0; s < n; ++s)
 	{
-		int currentItemSize = items[itemsIndexes[i]];
-		if (currentFill + currentItemSize <= binCapacity)
+		if (index[s] != -1) continue;
+		callStack.push_back({ s, 0 });
+		index[s] = low[s] = counter++;
+		stack.push_back(s);
+		onStack[s] = true;
+		while (!callStack.empty())
 		{
-			result.genes[currentBin].push_back(itemsIndexes[i]);
-			currentFill += currentItemSize;
-			++i;
+			int v = callStack.back().first;
+			int& next = callStack.back().second;
+			if (next < stationSuccessors[v].size())
+			{
+				int w = stationSuccessors[v][next++];
+				if (index[w] == -1)
+				{
+					index[w] = low[w] = counter++;
+					stack.push_back(w);
+					onStack[w] = true;
+					callStack.push_back({ w, 0 });
+				}
+				else if (onStack[w])
+					low[v] = std::min(low[v], index[w]);
+				continue;
+			}
+
+			callStack.pop_back();
+			if (!callStack.empty())
+				low[callStack.back().first] = std::min(low[callStack.back().first], low[v]);
+			if (low[v] == index[v])
+			{
+				int w;
+				do
+				{
+					w = stack.back();
+					stack.pop_back();
+					onStack[w] = false;
+					component[w] = componentEnds.size();
+					reversedOrder.push_back(w);
+				} while (w != v);
+				componentEnds.push_back(reversedOrder.size());
+			}
 		}
-		else
+	}
+
+	///order inside components
+	std::vector<int> inDegree(n);
+	for (int v = 0; v < n; ++v)
+		for (auto& w : stationSuccessors[v])
+			if (component[v] == component[w])
+				++inDegree[w];
+
+	std::vector<int> order;
+	order.reserve(n);
+	std::vector<bool> placed(n);
+	for (int c = componentEnds.size() - 1; c >= 0; --c)
+	{
+		int begin = c ? componentEnds[c - 1] : 0, end = componentEnds[c];
+		if (end - begin == 1)
+		{
+			order.push_back(reversedOrder[begin]);
+			continue;
+		}
+		std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> candidates;
+		for (int i = begin; i < end; ++i)
+			candidates.push({ inDegree[reversedOrder[i]], reversedOrder[i] });
+		while (!candidates.empty())
+		{
+			int d = candidates.top().first, v = candidates.top().second;
+			candidates.pop();
+			if (placed[v] || d != inDegree[v]) continue;
+			placed[v] = true;
+			order.push_back(v);
+			for (auto& w : stationSuccessors[v])
+				if (component[w] == c && !placed[w])
+					candidates.push({ --inDegree[w], w });
+		}
+	}
+
+	///report edges going backwards
+	std::vector<int> position(n);
+	for (int i = 0; i < n; ++i)
+		position[order[i]] = i;
+	for (int u = 0; u < successors.size(); ++u)
+		for (auto& v : successors[u])
 		{
-			++currentBin;
-			result.genes.push_back({});
+			int su = stationOf[u], sv = stationOf[v];
+			if (su == -1 || sv == -1 || su == sv) continue;
+			if (position[su] > position[sv])
+				violations.push_back({ u, v });
+		}
+
+	std::vector<std::vector<int>> sequenced(n);
+	for (int i = 0; i < n; ++i)
+		sequenced[i] = std::move(workstations[order[i]]);
+	workstations = std::move(sequenced);
+
+	return violations.empty();
+}
+
+/**
+FNV-1a over the bytes of x
+*/
+static uint64_t hashCombine(uint64_t hash, int64_t x)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		hash ^= uint64_t(x) >> (8 * i) & 0xFF;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+uint64_t GeneticBalancer::PrecedenceGraph::hash() const
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	hash = hashCombine(hash, successors.size());
+	for (auto& next : successors)
+	{
+		hash = hashCombine(hash, next.size());
+		for (int v : next)
+			hash = hashCombine(hash, v);
+	}
+	return hash;
+}
+
+/**
+Identifies the instance in checkpoints: task times, bin capacity and precedence edges
+*/
+uint64_t GeneticBalancer::Instance::hash() const
+{
+	uint64_t hash = precedenceGraph.hash();
+	hash = hashCombine(hash, binCapacity);
+	hash = hashCombine(hash, items.size());
+	for (int item : items)
+		hash = hashCombine(hash, item);
+	return hash;
+}
+
+template<typename Index>
+GeneticBalancer::Chromosome<Index> GeneticBalancer::randomChromosome()
+{
+	Chromosome<Index> result(*this);
+
+	result.genes.resize(instance->items.size());
+	for (int i = 0; i < result.genes.size(); ++i)
+		result.genes[i] = i;
+	std::shuffle(result.genes.begin(), result.genes.end(), rng);
+	int currentFill = 0;
+	for (int i = 0; i < result.genes.size(); ++i)
+	{
+		int currentItemSize = instance->items[result.genes[i]];
+		if (i > 0 && currentFill + currentItemSize > binCapacity)
+		{
+			result.binEnds.push_back(i);
 			currentFill = 0;
 		}
+		currentFill += currentItemSize;
 	}
+	if (!result.genes.empty())
+		result.binEnds.push_back(result.genes.size());
+	result.calcFitness();
+
+	return result;
+}
+
+/**
+Rebuilds a chromosome from bins found for another capacity
+Items are dropped from overfull bins until they fit, then redistributed using FFD
+*/
+template<typename Index>
+GeneticBalancer::Chromosome<Index> GeneticBalancer::seededChromosome(const std::vector<std::vector<int>>& bins)
+{
+	Chromosome<Index> result(*this);
+	std::vector<Index> overflow;
+	for (auto& bin : bins)
+	{
+		std::vector<Index> gene(bin.begin(), bin.end());
+		int fill = std::accumulate(gene.begin(), gene.end(), 0, [this](int sumSoFar, Index i) {return sumSoFar + instance->items[i]; });
+		while (fill > binCapacity)
+		{
+			fill -= instance->items[gene.back()];
+			overflow.push_back(gene.back());
+			gene.pop_back();
+		}
+		if (!gene.empty())
+			result.addBin(gene.begin(), gene.end());
+	}
+	std::sort(overflow.begin(), overflow.end(), [this](Index a, Index b) { return instance->items[a]>instance->items[b]; });
+	firstFit(overflow, result);
 	result.calcFitness();
 
 	return result;
@@ -81,12 +295,12 @@ GeneticBalancer::Chromosome GeneticBalancer::randomChromosome()
 
 double GeneticBalancer::randomZeroToOne()
 {
-	return rand() / (RAND_MAX + 1.);
+	return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
 }
 
 int GeneticBalancer::random(int min, int max)
 {
-	return rand() % (max - min + 1) + min;
+	return std::uniform_int_distribution<int>(min, max)(rng);
 }
 
 int GeneticBalancer::spinRoulette(const std::vector<double>& probabilities)
@@ -98,15 +312,19 @@ int GeneticBalancer::spinRoulette(const std::vector<double>& probabilities)
 
 /**
 Generates initial population
-The population is generated randomly and then sorted according to fitness
+Up to SEED_RATE of the population is warm-started from seedPopulation, the rest is generated randomly
+The population is then sorted according to fitness
 The first individual is the fittest
 */
-std::vector<GeneticBalancer::Chromosome> GeneticBalancer::initPopulation(int size)
+template<typename Index>
+std::vector<GeneticBalancer::Chromosome<Index>> GeneticBalancer::initPopulation(int size)
 {
-	std::vector<Chromosome> result;
+	std::vector<Chromosome<Index>> result;
 	result.reserve(size);
-	for (int i = 0; i < size; ++i)
-		result.push_back(randomChromosome());
+	for (int i = 0; i < size*SEED_RATE && i < seedPopulation.size(); ++i)
+		result.push_back(seededChromosome<Index>(seedPopulation[i]));
+	while (result.size() < size)
+		result.push_back(randomChromosome<Index>());
 	sortPopulation(result);
 	return result;
 }
@@ -116,11 +334,12 @@ Roulette Wheel Selection
 Population is guaranteed to be sorted
 The first individual is the fittest
 */
-std::pair<GeneticBalancer::Chromosome, GeneticBalancer::Chromosome> GeneticBalancer::selectParents(const std::vector<Chromosome>& population)
+template<typename Index>
+std::pair<GeneticBalancer::Chromosome<Index>, GeneticBalancer::Chromosome<Index>> GeneticBalancer::selectParents(const std::vector<Chromosome<Index>>& population)
 {
 	//prepare the Roulette
 	std::vector<double> probabilities(population.size());
-	double sum = std::accumulate(population.begin(), population.end(), 0.0, [](double sumSoFar, Chromosome current) {return sumSoFar + current.getFitness(); });
+	double sum = std::accumulate(population.begin(), population.end(), 0.0, [](double sumSoFar, const Chromosome<Index>& current) {return sumSoFar + current.getFitness(); });
 	for (int i = 0; i < population.size(); ++i)
 		probabilities[i] = population[i].getFitness()/sum + (i?probabilities[i-1]:0);
 	probabilities.back() = 1.0;
@@ -138,13 +357,14 @@ std::pair<GeneticBalancer::Chromosome, GeneticBalancer::Chromosome> GeneticBalan
 /**
 Stochastic universal sampling
 */
-std::vector<GeneticBalancer::Chromosome> GeneticBalancer::selectParents2(const std::vector<Chromosome>& population)
+template<typename Index>
+std::vector<GeneticBalancer::Chromosome<Index>> GeneticBalancer::selectParents2(const std::vector<Chromosome<Index>>& population)
 {
-	double sum = std::accumulate(population.begin(), population.end(), 0.0, [](double sumSoFar, Chromosome current) {return sumSoFar + current.getFitness(); });
+	double sum = std::accumulate(population.begin(), population.end(), 0.0, [](double sumSoFar, const Chromosome<Index>& current) {return sumSoFar + current.getFitness(); });
 	double dist = sum / (POPULATION_SIZE*CROSSOVER_RATE);
 	double start = randomZeroToOne() * dist;
 
-	std::vector<Chromosome> keep;
+	std::vector<Chromosome<Index>> keep;
 	std::vector<double> fitnessSum(population.size());
 	for (int i = 0; i < population.size(); ++i)
 		fitnessSum[i] = population[i].getFitness() + (i?fitnessSum[i-1]:0);
@@ -158,48 +378,125 @@ std::vector<GeneticBalancer::Chromosome> GeneticBalancer::selectParents2(const s
 		std::cout << j << " ";
 	}
 	std::cout << "\n";
-	std::random_shuffle(keep.begin(), keep.end());
+	std::shuffle(keep.begin(), keep.end(), rng);
 	return keep;
 }
 
-void GeneticBalancer::firstFit(const std::vector<int>& candidates, Chromosome & chromosome)
+template<typename Index>
+void GeneticBalancer::firstFit(const std::vector<Index>& candidates, Chromosome<Index>& chromosome)
 {
 	for (auto& item : candidates)
 	{
 		bool emplacedFlag = false;
-		for (int i = 0; i < chromosome.genes.size(); ++i)
-			if (std::accumulate(chromosome.genes[i].begin(), chromosome.genes[i].end(), 0, [this](int sumSoFar, int i) {return sumSoFar + items[i]; }) + items[item] < binCapacity)
+		for (int i = 0; i < chromosome.binCount(); ++i)
+			if (chromosome.binFill(i) + instance->items[item] < binCapacity)
 			{
 				bool cycleDangerFlag = false;
-				for (auto& alreadyPacked : chromosome.genes[i])
-					if (precedenceGraph.getMaxDistance(item, alreadyPacked) > 1)
+				for (int j = chromosome.binBegin(i); j < chromosome.binEnd(i); ++j)
+					if (instance->precedenceGraph.getMaxDistance(item, chromosome.genes[j]) > 1)
 						cycleDangerFlag = true;
 				if (cycleDangerFlag)
 				{
 					//std::cout << "--------------------------------------Cycle danger: " << item << " in [";
-					//for (auto& alreadyPacked : chromosome.genes[i]) std::cout << alreadyPacked << ",";
+					//for (int j = chromosome.binBegin(i); j < chromosome.binEnd(i); ++j) std::cout << chromosome.genes[j] << ",";
 					//std::cout << "]\n";
 
 					continue;
 				}
 
-				chromosome.genes[i].push_back(item);
+				chromosome.addToBin(i, item);
 				emplacedFlag = true;
 				break;
 			}
 		if (!emplacedFlag)
-			chromosome.genes.push_back({ item });
+			chromosome.addBin(&item, &item + 1);
 	}
 }
 
-void GeneticBalancer::sortPopulation(std::vector<Chromosome>& population)
+template<typename Index>
+void GeneticBalancer::sortPopulation(std::vector<Chromosome<Index>>& population)
 {
-	std::sort(population.begin(), population.end(), [](Chromosome a, Chromosome b) { return a.isFitter(b); });
+	std::sort(population.begin(), population.end(), [](const Chromosome<Index>& a, const Chromosome<Index>& b) { return a.isFitter(b); });
 	
 	//std::sort(population.begin(), population.end(), [](Chromosome a, Chromosome b) { return b.isFitter(a); });
 }
 
-void GeneticBalancer::printPopulation(const std::vector<Chromosome>& population, int id)
+/**
+Orders the population for the multi-objective search (NSGA-II): by non-dominated rank over station count
+and smoothness index, then by crowding distance within a rank, so the front spreads instead of collapsing
+*/
+template<typename Index>
+void GeneticBalancer::sortPopulationPareto(std::vector<Chromosome<Index>>& population)
+{
+	int n = population.size();
+	auto dominates = [&population](int a, int b) {
+		const auto& x = population[a];
+		const auto& y = population[b];
+		return x.getStations() <= y.getStations() && x.getSmoothness() <= y.getSmoothness()
+			&& (x.getStations() < y.getStations() || x.getSmoothness() < y.getSmoothness());
+	};
+
+	///peel off non-dominated fronts
+	std::vector<int> rank(n, -1);
+	std::vector<double> crowding(n, 0.0);
+	for (int r = 0, ranked = 0; ranked < n; ++r)
+	{
+		std::vector<int> front;
+		for (int i = 0; i < n; ++i)
+		{
+			if (rank[i] != -1)
+				continue;
+			bool dominated = false;
+			for (int j = 0; j < n && !dominated; ++j)
+				dominated = j != i && rank[j] == -1 && dominates(j, i);
+			if (!dominated)
+				front.push_back(i);
+		}
+		for (int i : front)
+			rank[i] = r;
+		ranked += front.size();
+
+		///crowding distance: the front is a staircase, so one order serves both objectives
+		std::sort(front.begin(), front.end(), [&population](int a, int b) {
+			return population[a].getStations() < population[b].getStations()
+				|| (population[a].getStations() == population[b].getStations() && population[a].getSmoothness() > population[b].getSmoothness());
+		});
+		crowding[front.front()] = crowding[front.back()] = std::numeric_limits<double>::infinity();
+		double stationsRange = std::max(1, population[front.back()].getStations() - population[front.front()].getStations());
+		double smoothnessRange = std::max(1e-9, population[front.front()].getSmoothness() - population[front.back()].getSmoothness());
+		for (int k = 1; k + 1 < front.size(); ++k)
+			crowding[front[k]] += (population[front[k + 1]].getStations() - population[front[k - 1]].getStations()) / stationsRange
+				+ std::abs(population[front[k - 1]].getSmoothness() - population[front[k + 1]].getSmoothness()) / smoothnessRange;
+	}
+
+	std::vector<int> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return rank[a] != rank[b] ? rank[a] < rank[b] : crowding[a] > crowding[b]; });
+	std::vector<Chromosome<Index>> sorted;
+	sorted.reserve(n);
+	for (int i : order)
+		sorted.push_back(population[i]);
+	population = std::move(sorted);
+}
+
+/**
+Binary tournament on the order set by sortPopulationPareto(): the earlier of two random individuals wins
+*/
+template<typename Index>
+std::pair<GeneticBalancer::Chromosome<Index>, GeneticBalancer::Chromosome<Index>> GeneticBalancer::selectParentsPareto(const std::vector<Chromosome<Index>>& population)
+{
+	int last = population.size() - 1;
+	int id1 = std::min(random(0, last), random(0, last)), id2;
+	do
+	{
+		id2 = std::min(random(0, last), random(0, last));
+	} while (id1 == id2);
+
+	return {population[id1], population[id2]};
+}
+
+template<typename Index>
+void GeneticBalancer::printPopulation(const std::vector<Chromosome<Index>>& population, int id)
 {
 	std::cout << "\n\n\n\n\n\n------ " << id << " ---------------------------------------------------------------------------------------------------------------------------------------------\n";
 	int maxLen = 0;
@@ -213,76 +510,167 @@ void GeneticBalancer::printPopulation(const std::vector<Chromosome>& population,
 	std::cout << "\n";
 }
 
-void GeneticBalancer::Chromosome::calcFitness()
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::calcFitness()
 {
-	double sum = 0.0;
-	for (auto& gene : genes)
+	long long fillSum = 0, fillSquares = 0;
+	int maxFill = 0;
+	for (int i = 0; i < binCount(); ++i)
 	{
-		int fill = 0;
-		for (auto& item : gene)
-			fill += parent.items[item];
-		sum += std::pow(1.0*fill / parent.binCapacity, 2);
+		long long fill = binFill(i);
+		fillSum += fill;
+		fillSquares += fill * fill;
+		maxFill = std::max<int>(maxFill, fill);
 	}
-	fitness = sum / genes.size();
+	fitness = fillSquares / (1.0 * parent.binCapacity * parent.binCapacity) / binCount();
+
+	///smoothness index: sqrt(sum((maxFill - fill)^2)) expanded over the same sums, exact in integers
+	smoothness = std::sqrt(double(binCount() * (long long)maxFill * maxFill - 2LL * maxFill * fillSum + fillSquares));
 }
 
-GeneticBalancer::Chromosome & GeneticBalancer::Chromosome::operator=(const Chromosome & b)
+template<typename Index>
+GeneticBalancer::Chromosome<Index>& GeneticBalancer::Chromosome<Index>::operator=(const Chromosome & b)
 {
 	//TODO: if (parent != b.parent) throw exception;
 	genes = b.genes;
+	binEnds = b.binEnds;
 	fitness = b.fitness;
+	smoothness = b.smoothness;
 	return *this;
 }
 
-bool GeneticBalancer::Chromosome::isFitter(const Chromosome & b) const
+template<typename Index>
+int GeneticBalancer::Chromosome<Index>::binFill(int i) const
+{
+	int fill = 0;
+	for (int j = binBegin(i); j < binEnd(i); ++j)
+		fill += parent.instance->items[genes[j]];
+	return fill;
+}
+
+template<typename Index>
+template<typename It>
+void GeneticBalancer::Chromosome<Index>::addBin(It first, It last)
+{
+	genes.insert(genes.end(), first, last);
+	binEnds.push_back(genes.size());
+}
+
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::addToBin(int i, Index item)
+{
+	genes.insert(genes.begin() + binEnd(i), item);
+	for (int j = i; j < binCount(); ++j)
+		++binEnds[j];
+}
+
+template<typename Index>
+Index GeneticBalancer::Chromosome<Index>::removeFromBin(int i, int position)
+{
+	Index item = genes[binBegin(i) + position];
+	genes.erase(genes.begin() + binBegin(i) + position);
+	for (int j = i; j < binCount(); ++j)
+		--binEnds[j];
+	return item;
+}
+
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::eraseBins(const std::vector<bool>& erase)
+{
+	int to = 0, bins = 0;
+	for (int i = 0; i < binCount(); ++i)
+	{
+		if (erase[i]) continue;
+		int from = binBegin(i), end = binEnd(i);
+		while (from < end)
+			genes[to++] = genes[from++];
+		binEnds[bins++] = to;
+	}
+	genes.resize(to);
+	binEnds.resize(bins);
+}
+
+/**
+Inserts bins [first, last) of `from` before bin `position`
+*/
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::insertBins(int position, const Chromosome& from, int first, int last)
+{
+	int at = binBegin(position), begin = from.binBegin(first), count = from.binBegin(last) - begin;
+	genes.insert(genes.begin() + at, from.genes.begin() + begin, from.genes.begin() + begin + count);
+	for (int j = position; j < binCount(); ++j)
+		binEnds[j] += count;
+	std::vector<Index> inserted;
+	for (int i = first; i < last; ++i)
+		inserted.push_back(at + from.binEnd(i) - begin);
+	binEnds.insert(binEnds.begin() + position, inserted.begin(), inserted.end());
+}
+
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::reorderBins(const std::vector<int>& order)
+{
+	std::vector<Index> reordered, reorderedEnds;
+	reordered.reserve(genes.size());
+	reorderedEnds.reserve(binEnds.size());
+	for (auto& i : order)
+	{
+		reordered.insert(reordered.end(), genes.begin() + binBegin(i), genes.begin() + binEnd(i));
+		reorderedEnds.push_back(reordered.size());
+	}
+	genes = std::move(reordered);
+	binEnds = std::move(reorderedEnds);
+}
+
+template<typename Index>
+bool GeneticBalancer::Chromosome<Index>::isFitter(const Chromosome & b) const
 {
 	return this->fitness > b.fitness;
 }
 
-bool GeneticBalancer::Chromosome::isMaximallyFit() const
+template<typename Index>
+bool GeneticBalancer::Chromosome<Index>::isMaximallyFit() const
 {
 	return fitness == 1.0;
 }
 
-GeneticBalancer::Chromosome GeneticBalancer::crossover(const GeneticBalancer::Chromosome & parent1, const GeneticBalancer::Chromosome & parent2)
+template<typename Index>
+GeneticBalancer::Chromosome<Index> GeneticBalancer::crossover(const Chromosome<Index>& parent1, const Chromosome<Index>& parent2)
 {
-	Chromosome child = parent2;
+	Chromosome<Index> child = parent2;
 	
 	///1.Select Crossing Section
-	int left = random(0, parent1.genes.size()-1), right = random(0, parent1.genes.size() - 1);
+	int left = random(0, parent1.binCount()-1), right = random(0, parent1.binCount() - 1);
 	if (left > right) std::swap(left, right);
 
 	///3.Eliminate Doubles & 4.1.Identify Affected Items
-	std::vector<int> affectedItems;
-	for (int i = left; i <= right; ++i)
+	std::vector<int> binOf(instance->items.size());
+	for (int j = 0; j < child.binCount(); ++j)
+		for (int k = child.binBegin(j); k < child.binEnd(j); ++k)
+			binOf[child.genes[k]] = j;
+	std::vector<bool> eliminated(child.binCount());
+	std::vector<Index> affectedItems;
+	for (int i = parent1.binBegin(left); i < parent1.binEnd(right); ++i)
 	{
-		for (auto& item : parent1.genes[i])
+		Index item = parent1.genes[i];
+		int j = binOf[item];
+		if (!eliminated[j])
 		{
-			bool foundFlag = false;
-			for (int j = 0; foundFlag==false && j<child.genes.size(); ++j)
-				for (int k = 0; k < child.genes[j].size(); ++k)
-					if (child.genes[j][k] == item)
-					{
-						affectedItems.insert(affectedItems.end(), child.genes[j].begin(), child.genes[j].end());
-						child.genes.erase(child.genes.begin() + j);
-						foundFlag = true;
-						break;
-					}
-
-			affectedItems.erase(std::remove_if(
-				affectedItems.begin(), affectedItems.end(),
-				[item](int x) { return x==item; }
-			), affectedItems.end());
+			affectedItems.insert(affectedItems.end(), child.genes.begin() + child.binBegin(j), child.genes.begin() + child.binEnd(j));
+			eliminated[j] = true;
 		}
+
+		affectedItems.erase(std::remove_if(
+			affectedItems.begin(), affectedItems.end(),
+			[item](Index x) { return x==item; }
+		), affectedItems.end());
 	}
+	child.eraseBins(eliminated);
 
 	///2.Insert Crossing Section Groups
-	child.genes.insert(child.genes.begin() + random(0, child.genes.size()),
-		parent1.genes.begin() + left,
-		parent1.genes.begin() + right + 1);
+	child.insertBins(random(0, child.binCount()), parent1, left, right + 1);
 	
 	///4.2.Redistribute Affected Items [using FFD]
-	std::sort(affectedItems.begin(), affectedItems.end(), [this](int a, int b) { return items[a]>items[b]; });
+	std::sort(affectedItems.begin(), affectedItems.end(), [this](Index a, Index b) { return instance->items[a]>instance->items[b]; });
 	firstFit(affectedItems, child);
 
 	///recalculate fitness
@@ -303,20 +691,23 @@ GeneticBalancer::Chromosome GeneticBalancer::crossover(const GeneticBalancer::Ch
 	return child;
 }
 
-void GeneticBalancer::Chromosome::mutate()
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::mutate()
 {
 	auto temp = *this;
 	///randomly select eliminations
-	std::vector<bool> willBeEliminated(genes.size());
-	willBeEliminated[std::distance(genes.begin(),
-									std::min_element(genes.begin(), genes.end(), [](std::vector<int> a, std::vector<int> b) { return a.size() < b.size(); }))
-	                ] = true; //smallest bin
-	if (parent.MAX_MUTATION_SEVERITY*genes.size() >= 3) //minimum 3 bins
+	std::vector<bool> willBeEliminated(binCount());
+	int smallest = 0;
+	for (int i = 1; i < binCount(); ++i)
+		if (binSize(i) < binSize(smallest))
+			smallest = i;
+	willBeEliminated[smallest] = true;
+	if (parent.MAX_MUTATION_SEVERITY*binCount() >= 3) //minimum 3 bins
 	{
-		for (int i = parent.random(2, parent.MAX_MUTATION_SEVERITY*genes.size() - 1); i > 0; --i)
+		for (int i = parent.random(2, parent.MAX_MUTATION_SEVERITY*binCount() - 1); i > 0; --i)
 		{
 			int j;
-			do { j = parent.random(0, genes.size() - 1); } while (willBeEliminated[j]);
+			do { j = parent.random(0, binCount() - 1); } while (willBeEliminated[j]);
 			willBeEliminated[j] = true;
 		}
 	}
@@ -325,23 +716,14 @@ void GeneticBalancer::Chromosome::mutate()
 	//std::cout << "\n";
 
 	///eliminate
-	std::vector<int> eliminated;
+	std::vector<Index> eliminated;
 	for (int i = 0; i < willBeEliminated.size(); ++i)
-	{
 		if (willBeEliminated[i])
-		{
-			for (auto& item : genes[i]) eliminated.push_back(item);
-			genes[i].clear();
-		}
-	}
-	genes.erase(std::remove_if(
-		genes.begin(), genes.end(),
-		[](std::vector<int> x) {
-		return x.empty();
-	}), genes.end());
+			eliminated.insert(eliminated.end(), genes.begin() + binBegin(i), genes.begin() + binEnd(i));
+	eraseBins(willBeEliminated);
 	
 	///ff
-	std::random_shuffle(eliminated.begin(), eliminated.end());
+	std::shuffle(eliminated.begin(), eliminated.end(), parent.rng);
 	parent.firstFit(eliminated, *this);
 
 	///recalculate fitness
@@ -354,62 +736,604 @@ void GeneticBalancer::Chromosome::mutate()
 	}*/
 }
 
-void GeneticBalancer::Chromosome::inverse()
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::inverse()
 {
 	//std::cout << "%%%%%%%%%%%%%%%%%%%%%Inversed\n" << toString() << " to\n";
-	std::sort(genes.begin(), genes.end(),
-		[](const std::vector<int>& a, const std::vector<int>& b) {
-		return std::accumulate(a.begin(),a.end(),0) > std::accumulate(b.begin(), b.end(), 0);
-	});
+	int n = binCount();
+	std::vector<int> sums(n), sorted(n);
+	for (int i = 0; i < n; ++i)
+	{
+		sums[i] = std::accumulate(genes.begin() + binBegin(i), genes.begin() + binEnd(i), 0);
+		sorted[i] = i;
+	}
+	std::sort(sorted.begin(), sorted.end(), [&sums](int a, int b) { return sums[a] > sums[b]; });
 	//std::cout << toString() << "to\n";
-	int n = genes.size();
-	decltype(genes) temp(n);
-	int tempI = 0;
-	for (int i = n - 2; i >= 0; i -= 2) temp[tempI++] = genes[i];
-	for (int i = !(n%2); i < n; i += 2) temp[tempI++] = genes[i];
-	genes = temp;
+	std::vector<int> order(n);
+	int orderI = 0;
+	for (int i = n - 2; i >= 0; i -= 2) order[orderI++] = sorted[i];
+	for (int i = !(n%2); i < n; i += 2) order[orderI++] = sorted[i];
+	reorderBins(order);
 	//std::cout << toString() << "\n";
 }
 
-std::string GeneticBalancer::Chromosome::toString() const
+/**
+Opens up to openedStations empty bins, then keeps taking an item out of the fullest bin: into the bin it leaves
+emptiest, or swapped for a smaller item of such a bin, as long as that bin stays below the old maximum
+Capacity and the precedence rule of firstFit() are respected
+Every step lowers the sum of squared fills, so it terminates; it lowers the smoothness index, possibly at the cost
+of stations: this is what spreads the Pareto front
+*/
+template<typename Index>
+void GeneticBalancer::Chromosome<Index>::level(int openedStations)
+{
+	for (int i = 0; i < openedStations; ++i)
+		addBin(genes.end(), genes.end());
+	std::vector<int> fills(binCount()), binOf(genes.size());
+	for (int i = 0; i < binCount(); ++i)
+		fills[i] = binFill(i);
+
+	///can item join bin b once `except` (a position in genes, or -1) has left it
+	auto fitsWith = [this](Index item, int b, int except) {
+		for (int k = binBegin(b); k < binEnd(b); ++k)
+			if (k != except && parent.instance->precedenceGraph.getMaxDistance(item, genes[k]) > 1)
+				return false;
+		return true;
+	};
+
+	while (true)
+	{
+		int hi = std::max_element(fills.begin(), fills.end()) - fills.begin();
+		for (int i = 0; i < binCount(); ++i)
+			for (int k = binBegin(i); k < binEnd(i); ++k)
+				binOf[k] = i;
+
+		///best move (other == -1) or swap with genes[other]: the lowest fill it leaves in the receiving bin
+		int bestFill = fills[hi], bestItem = -1, bestBin = -1, bestOther = -1;
+		for (int j = binBegin(hi); j < binEnd(hi); ++j)
+		{
+			int size = parent.instance->items[genes[j]];
+			for (int b = 0; b < binCount(); ++b)
+				if (fills[b] + size < bestFill && fills[b] + size < parent.binCapacity && fitsWith(genes[j], b, -1))
+				{
+					bestFill = fills[b] + size;
+					bestItem = j;
+					bestBin = b;
+					bestOther = -1;
+				}
+			for (int k = 0; k < genes.size(); ++k)
+			{
+				int b = binOf[k], otherSize = parent.instance->items[genes[k]];
+				int fill = fills[b] - otherSize + size;
+				if (b == hi || otherSize >= size || fill >= bestFill || fill >= parent.binCapacity)
+					continue;
+				if (!fitsWith(genes[j], b, k) || !fitsWith(genes[k], hi, j))
+					continue;
+				bestFill = fill;
+				bestItem = j;
+				bestBin = b;
+				bestOther = k;
+			}
+		}
+		if (bestItem == -1)
+			break;
+
+		int size = parent.instance->items[genes[bestItem]];
+		if (bestOther == -1)
+		{
+			Index item = removeFromBin(hi, bestItem - binBegin(hi));
+			addToBin(bestBin, item);
+			fills[hi] -= size;
+			fills[bestBin] += size;
+		}
+		else
+		{
+			int otherSize = parent.instance->items[genes[bestOther]];
+			std::swap(genes[bestItem], genes[bestOther]);
+			fills[hi] += otherSize - size;
+			fills[bestBin] += size - otherSize;
+		}
+	}
+
+	///opened bins that got nothing
+	std::vector<bool> empty(binCount());
+	for (int i = 0; i < binCount(); ++i)
+		empty[i] = binSize(i) == 0;
+	eraseBins(empty);
+	calcFitness();
+}
+
+template<typename Index>
+std::string GeneticBalancer::Chromosome<Index>::toString() const
 {
 	std::stringstream ss;
 	ss << "[";
-	for (int i = 0; i < genes.size(); ++i)
+	for (int i = 0; i < binCount(); ++i)
 	{
-		for (int j = 0; j < genes[i].size(); ++j)
+		for (int j = binBegin(i); j < binEnd(i); ++j)
 		{
-			ss << genes[i][j];
-			if (j < genes[i].size()-1) ss << ",";
+			ss << int(genes[j]);
+			if (j < binEnd(i)-1) ss << ",";
 		}
 		int w = 23;
 		if ((i + 1) * w + 1 > ss.str().size())
 			ss << std::string((i + 1) * w + 1 - ss.str().size(), ' ');
-		if (i < genes.size()-1) ss << "|";
+		if (i < binCount()-1) ss << "|";
 	}
 	ss << "]";
 	return ss.str();
 }
 
-std::vector<std::vector<int>> GeneticBalancer::Chromosome::toBins()
+template<typename Index>
+std::vector<std::vector<int>> GeneticBalancer::Chromosome<Index>::toBins() const
 {
-	for (auto& workstation : genes)
-		std::sort(workstation.begin(), workstation.end());
-	std::sort(genes.begin(), genes.end(), [](const std::vector<int>& a, const std::vector<int>& b) { return a[0] < b[0]; });
-	return genes;
+	std::vector<std::vector<int>> bins;
+	bins.reserve(binCount());
+	for (int i = 0; i < binCount(); ++i)
+	{
+		bins.emplace_back(genes.begin() + binBegin(i), genes.begin() + binEnd(i));
+		std::sort(bins.back().begin(), bins.back().end());
+	}
+	std::sort(bins.begin(), bins.end(), [](const std::vector<int>& a, const std::vector<int>& b) { return a[0] < b[0]; });
+	return bins;
+}
+
+/**
+Publishes the fittest individual if it beats the last published one
+Population is guaranteed to be sorted
+*/
+template<typename Index>
+void GeneticBalancer::publishBest(const std::vector<Chromosome<Index>>& population, int generation)
+{
+	const auto& best = population.front();
+	if (progress->publishedFitness >= best.getFitness())
+		return;
+
+	auto& snapshot = progress->buffers[progress->back];
+	snapshot.generation = generation;
+	snapshot.fitness = best.getFitness();
+	snapshot.workstations = best.toBins();
+	instance->precedenceGraph.sequenceWorkstations(snapshot.workstations, snapshot.violations);
+	progress->publishedFitness = snapshot.fitness;
+	progress->publish();
+}
+
+template<typename T>
+static void appendRaw(std::string& buffer, const T& x)
+{
+	buffer.append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+template<typename T>
+static bool readRaw(std::istream& in, T& x)
+{
+	return bool(in.read(reinterpret_cast<char*>(&x), sizeof(x)));
+}
+
+/**
+Moves from onto to, atomically replacing an existing file
+*/
+static bool replaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static const char CHECKPOINT_MAGIC[4] = { 'G', 'G', 'A', '2' };
+
+/**
+Serialises the population into the free buffer on the calling thread, the file is written on a background thread
+Layout: magic, index size, item count, bin capacity, instance hash, generation, RNG state, best fitness history,
+then for every chromosome its fitness, smoothness and bins
+The buffer goes to file.tmp, which then atomically replaces file, so a crash leaves either the old or the new checkpoint
+A failed write or rename keeps the previous checkpoint and is reported by checkpointFailed()
+*/
+template<typename Index>
+void GeneticBalancer::writeCheckpoint(const std::vector<Chromosome<Index>>& population, int generation, const std::vector<double>& bestFitness)
+{
+	std::string& buffer = checkpointBuffers[checkpointBuffer];
+	buffer.clear();
+	buffer.append(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	appendRaw(buffer, uint32_t(sizeof(Index)));
+	appendRaw(buffer, uint32_t(instance->items.size()));
+	appendRaw(buffer, int32_t(binCapacity));
+	appendRaw(buffer, instance->hash());
+	appendRaw(buffer, int32_t(generation));
+
+	std::stringstream rngState;
+	rngState << rng;
+	appendRaw(buffer, uint32_t(rngState.str().size()));
+	buffer.append(rngState.str());
+
+	appendRaw(buffer, uint32_t(bestFitness.size()));
+	for (auto& f : bestFitness)
+		appendRaw(buffer, f);
+
+	appendRaw(buffer, uint32_t(population.size()));
+	for (auto& individual : population)
+	{
+		appendRaw(buffer, individual.fitness);
+		appendRaw(buffer, individual.smoothness);
+		appendRaw(buffer, uint32_t(individual.binCount()));
+		for (int i = 0; i < individual.binCount(); ++i)
+		{
+			appendRaw(buffer, uint32_t(individual.binSize(i)));
+			buffer.append(reinterpret_cast<const char*>(individual.genes.data() + individual.binBegin(i)), individual.binSize(i) * sizeof(Index));
+		}
+	}
+
+	///the other buffer is free once the previous flush is done
+	waitForFlush();
+	pendingFlush = std::async(std::launch::async, [&buffer](std::string file) {
+		std::string temp = file + ".tmp";
+		std::ofstream out(temp, std::ios::binary);
+		out.write(buffer.data(), buffer.size());
+		out.close();
+		if (!out || !replaceFile(temp, file))
+		{
+			std::remove(temp.c_str());
+			return false;
+		}
+		return true;
+	}, checkpointFile);
+	checkpointBuffer ^= 1;
+}
+
+void GeneticBalancer::waitForFlush()
+{
+	if (pendingFlush.valid() && !pendingFlush.get())
+		checkpointError = true;
+}
+
+/**
+Loads a checkpoint written by writeCheckpoint() for the current instance into resumeFrom
+Every count is checked against the header and the bytes left in the file before anything is allocated,
+every chromosome must hold each item exactly once, and the stored fitness and smoothness must match
+a recomputation, in the sorted order gga() relies on
+*/
+bool GeneticBalancer::readCheckpoint(const std::string& file)
+{
+	const Instance& instance = *this->instance;
+	std::ifstream in(file, std::ios::binary);
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+	if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC))
+		return false;
+	std::streamoff position = in.tellg();
+	in.seekg(0, std::ios::end);
+	std::streamoff fileSize = in.tellg();
+	in.seekg(position);
+	auto fits = [&](uint64_t count, uint64_t bytes) { return count <= uint64_t(fileSize - in.tellg()) / bytes; };
+
+	uint32_t geneSize, itemsCount, count;
+	int32_t capacity, generation;
+	uint64_t hash;
+	if (!readRaw(in, geneSize) || !readRaw(in, itemsCount) || !readRaw(in, capacity) || !readRaw(in, hash) || !readRaw(in, generation))
+		return false;
+	if (itemsCount != instance.items.size() || capacity != instance.binCapacity || hash != instance.hash())
+		return false;
+	if (geneSize != indexSize(itemsCount) || generation < 0 || generation >= MAX_NO_OF_GENERATIONS)
+		return false;
+
+	std::unique_ptr<Checkpoint> checkpoint(new Checkpoint);
+	checkpoint->generation = generation;
+	if (!readRaw(in, count) || count == 0 || !fits(count, 1))
+		return false;
+	checkpoint->rngState.resize(count);
+	if (!in.read(&checkpoint->rngState[0], count))
+		return false;
+	std::mt19937 restoredRng;
+	if (!(std::stringstream(checkpoint->rngState) >> restoredRng))
+		return false;
+
+	if (!readRaw(in, count) || !fits(count, sizeof(double)))
+		return false;
+	checkpoint->bestFitness.resize(count);
+	for (auto& f : checkpoint->bestFitness)
+		if (!readRaw(in, f))
+			return false;
+
+	if (!readRaw(in, count) || count != uint32_t(POPULATION_SIZE) || !fits(count, 2 * sizeof(double) + sizeof(uint32_t)))
+		return false;
+	checkpoint->genes.resize(count);
+	checkpoint->fitness.resize(count);
+	checkpoint->smoothness.resize(count);
+	std::vector<bool> placed(itemsCount);
+	for (int i = 0; i < count; ++i)
+	{
+		uint32_t bins, size, left = itemsCount;
+		if (!readRaw(in, checkpoint->fitness[i]) || !readRaw(in, checkpoint->smoothness[i]) || !readRaw(in, bins))
+			return false;
+		if (bins == 0 || bins > itemsCount || !fits(bins, sizeof(uint32_t)))
+			return false;
+		std::fill(placed.begin(), placed.end(), false);
+		checkpoint->genes[i].resize(bins);
+		for (auto& gene : checkpoint->genes[i])
+		{
+			if (!readRaw(in, size) || size == 0 || size > left || !fits(size, geneSize))
+				return false;
+			left -= size;
+			gene.resize(size);
+			for (auto& item : gene)
+			{
+				uint32_t x = 0;
+				if (!in.read(reinterpret_cast<char*>(&x), geneSize) || x >= itemsCount || placed[x])
+					return false;
+				placed[x] = true;
+				item = x;
+			}
+		}
+		if (left != 0)
+			return false;
+
+		Chromosome<int> individual(*this);
+		for (auto& gene : checkpoint->genes[i])
+			individual.addBin(gene.begin(), gene.end());
+		individual.calcFitness();
+		if (individual.fitness != checkpoint->fitness[i] || individual.smoothness != checkpoint->smoothness[i])
+			return false;
+		if (i > 0 && checkpoint->fitness[i] > checkpoint->fitness[i - 1])
+			return false;
+	}
+	if (in.peek() != std::ifstream::traits_type::eof())
+		return false;
+
+	resumeFrom = std::move(checkpoint);
+	return true;
+}
+
+/**
+Rebuilds the population and RNG from resumeFrom, which is consumed
+*/
+template<typename Index>
+std::vector<GeneticBalancer::Chromosome<Index>> GeneticBalancer::restoreCheckpoint(int& generation, std::vector<double>& bestFitness)
+{
+	std::unique_ptr<Checkpoint> checkpoint = std::move(resumeFrom);
+	generation = checkpoint->generation;
+	bestFitness = checkpoint->bestFitness;
+	std::stringstream(checkpoint->rngState) >> rng;
+
+	std::vector<Chromosome<Index>> population;
+	population.reserve(checkpoint->genes.size());
+	for (int i = 0; i < checkpoint->genes.size(); ++i)
+	{
+		Chromosome<Index> individual(*this);
+		for (auto& gene : checkpoint->genes[i])
+			individual.addBin(gene.begin(), gene.end());
+		individual.fitness = checkpoint->fitness[i];
+		individual.smoothness = checkpoint->smoothness[i];
+		population.push_back(individual);
+	}
+	return population;
+}
+
+bool GeneticBalancer::ParetoArchive::isDominated(int stations, double smoothness) const
+{
+	///the smoothest solution with no more stations is the last one not above `stations`
+	auto it = front.upper_bound(stations);
+	return it != front.begin() && std::prev(it)->second.smoothness <= smoothness;
+}
+
+/**
+Solution must not be dominated (see isDominated)
+Amortised O(log n): the solutions it dominates follow it in the staircase
+*/
+void GeneticBalancer::ParetoArchive::insert(ParetoSolution solution)
+{
+	auto it = front.emplace(solution.stations, ParetoSolution()).first;
+	it->second = std::move(solution);
+	auto last = std::next(it);
+	while (last != front.end() && last->second.smoothness >= it->second.smoothness)
+		++last;
+	front.erase(std::next(it), last);
+}
+
+template<typename Index>
+void GeneticBalancer::archivePopulation(const std::vector<Chromosome<Index>>& population, ParetoArchive& archive)
+{
+	for (auto& individual : population)
+		if (!archive.isDominated(individual.getStations(), individual.getSmoothness()))
+			archive.insert({ individual.getStations(), individual.getSmoothness(), individual.toBins(), {} });
 }
 
 //=============================================================================================================================================================
-std::vector<std::vector<int>> GeneticBalancer::balance(std::vector<int> items, int binCapacity, const PrecedenceGraph& pg, std::vector<double>& bestFitness, long& elapsedTime)
+/**
+Size of the narrowest gene type that can index itemsCount items
+*/
+int GeneticBalancer::indexSize(size_t itemsCount)
+{
+	if (itemsCount <= std::numeric_limits<uint8_t>::max())
+		return sizeof(uint8_t);
+	else if (itemsCount <= std::numeric_limits<uint16_t>::max())
+		return sizeof(uint16_t);
+	else
+		return sizeof(int);
+}
+
+std::vector<std::vector<int>> GeneticBalancer::solve(std::vector<double>& bestFitness, ParetoArchive* archive)
+{
+	switch (indexSize(instance->items.size()))
+	{
+	case sizeof(uint8_t):
+		return gga<uint8_t>(bestFitness, archive);
+	case sizeof(uint16_t):
+		return gga<uint16_t>(bestFitness, archive);
+	default:
+		return gga<int>(bestFitness, archive);
+	}
+}
+
+std::vector<std::vector<int>> GeneticBalancer::balance(std::shared_ptr<const Instance> instance, std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations)
+{
+	this->instance = std::move(instance);
+	this->binCapacity = this->instance->binCapacity;
+	seedPopulation.clear();
+	rng.seed(1337);
+
+	std::clock_t start;
+	start = std::clock();
+	checkpointing = true;
+	auto result = solve(bestFitness, nullptr);
+	checkpointing = false;
+	this->instance->precedenceGraph.sequenceWorkstations(result, violations);
+	elapsedTime = (std::clock() - start) / (double)(CLOCKS_PER_SEC / 1000);
+	return result;
+}
+
+/**
+Runs balance() on its own thread
+The handle exposes the best solution so far and stops the run between generations on cancel()
+*/
+GeneticBalancer::BalanceHandle GeneticBalancer::balanceAsync(std::shared_ptr<const Instance> instance)
+{
+	auto progress = std::make_shared<Progress>();
+	auto result = std::async(std::launch::async, [progress, instance]() {
+		GeneticBalancer balancer;
+		balancer.progress = progress.get();
+		Result result;
+		result.workstations = balancer.balance(instance, result.bestFitness, result.elapsedTime, result.violations);
+		return result;
+	});
+	return BalanceHandle(std::move(progress), std::move(result));
+}
+
+GeneticBalancer::BalanceHandle& GeneticBalancer::BalanceHandle::operator=(BalanceHandle&& other)
+{
+	if (this != &other)
+	{
+		cancel();
+		progress = std::move(other.progress);
+		result = std::move(other.result);
+	}
+	return *this;
+}
+
+GeneticBalancer::BalanceHandle::~BalanceHandle()
+{
+	cancel();
+}
+
+/**
+Copies the latest snapshot, returns false if nothing has been published yet
+*/
+bool GeneticBalancer::BalanceHandle::best(Snapshot& snapshot)
+{
+	if (!progress)
+		return false;
+	if (progress->middle.load(std::memory_order_relaxed) & Progress::FRESH)
+	{
+		progress->front = progress->middle.exchange(progress->front, std::memory_order_acq_rel) & ~Progress::FRESH;
+		progress->received = true;
+	}
+	if (!progress->received)
+		return false;
+	snapshot = progress->buffers[progress->front];
+	return true;
+}
+
+/**
+Waits for the run to finish, cancelled or not
+*/
+std::vector<std::vector<int>> GeneticBalancer::BalanceHandle::get(std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations)
+{
+	if (!result.valid())
+		return {};
+	Result finished = result.get();
+	bestFitness = std::move(finished.bestFitness);
+	elapsedTime = finished.elapsedTime;
+	violations = std::move(finished.violations);
+	return std::move(finished.workstations);
+}
+
+/**
+Continues a balance() run from a checkpoint written with setCheckpoint()
+Gives the same result as the uninterrupted run would have
+Returns no workstations if the file is missing, corrupt or belongs to another instance
+*/
+std::vector<std::vector<int>> GeneticBalancer::resume(std::shared_ptr<const Instance> instance, const std::string& file, std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations)
+{
+	this->instance = instance;
+	this->binCapacity = instance->binCapacity;
+	if (!readCheckpoint(file))
+		return {};
+	return balance(std::move(instance), bestFitness, elapsedTime, violations);
+}
+
+/**
+Minimises station count and smoothness index at once
+Selection is Pareto-aware (see sortPopulationPareto()) and every individual produced is offered to a Pareto archive
+Returns the non-dominated set ordered by station count, each solution sequenced along the line
+*/
+std::vector<GeneticBalancer::ParetoSolution> GeneticBalancer::balanceMultiObjective(std::shared_ptr<const Instance> instance, std::vector<double>& bestFitness, long& elapsedTime)
 {
-	this->items = items;
-	this->binCapacity = binCapacity;
-	this->precedenceGraph = pg;
-	srand(1337);
+	this->instance = std::move(instance);
+	this->binCapacity = this->instance->binCapacity;
+	seedPopulation.clear();
+	rng.seed(1337);
 
 	std::clock_t start;
 	start = std::clock();
-	auto result = gga(bestFitness);
+	ParetoArchive archive;
+	solve(bestFitness, &archive);
+	auto result = archive.toVector();
+	for (auto& solution : result)
+		this->instance->precedenceGraph.sequenceWorkstations(solution.workstations, solution.violations);
+	elapsedTime = (std::clock() - start) / (double)(CLOCKS_PER_SEC / 1000);
+	return result;
+}
+
+/**
+Cycle time minimisation (SALBP-2) for a fixed number of stations
+Binary search over binCapacity between the lower bound max(largest task, ceil(total/stations))
+and the total work content
+The binCapacity of the instance is ignored
+Each probe is a GGA run warm-started from the final population of the previous probe
+A probe is feasible when the GGA packs the tasks into at most `stations` stations; like balance(), this
+ignores precedence between stations, so the chosen line may still have violations (reported in `violations`)
+A probe that fails moves the lower end up, so only the lower bound is proven
+Returns no workstations and cycleTime 0 if stations < 1, there are no tasks or no probe succeeded
+*/
+std::vector<std::vector<int>> GeneticBalancer::balanceCycleTime(std::shared_ptr<const Instance> instance, int stations, std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations, int& cycleTime)
+{
+	cycleTime = 0;
+	elapsedTime = 0;
+	violations.clear();
+	if (stations < 1 || instance->items.empty())
+		return {};
+
+	this->instance = std::move(instance);
+	auto& items = this->instance->items;
+	seedPopulation.clear();
+	rng.seed(1337);
+
+	std::clock_t start;
+	start = std::clock();
+
+	int total = std::accumulate(items.begin(), items.end(), 0);
+	int lo = std::max(*std::max_element(items.begin(), items.end()), (total + stations - 1) / stations);
+	int hi = total;
+	std::vector<std::vector<int>> result;
+
+	while (lo <= hi)
+	{
+		binCapacity = lo + (hi - lo) / 2;
+		std::vector<double> probeFitness;
+		auto probe = solve(probeFitness, nullptr);
+		if (probe.size() <= stations)
+		{
+			cycleTime = binCapacity;
+			hi = binCapacity - 1;
+			result = probe;
+			bestFitness = probeFitness;
+		}
+		else
+			lo = binCapacity + 1;
+	}
+
+	if (!result.empty())
+		this->instance->precedenceGraph.sequenceWorkstations(result, violations);
 	elapsedTime = (std::clock() - start) / (double)(CLOCKS_PER_SEC / 1000);
 	return result;
 }
@@ -419,20 +1343,42 @@ Genetic Grouping Algorithm
 
 Population is always sorted by fitness
 The first individual is the fittest
+With an archive it is sorted by sortPopulationPareto() instead, and parents are drawn by tournament
 */
-std::vector<std::vector<int>> GeneticBalancer::gga(std::vector<double>& bestFitness)
+template<typename Index>
+std::vector<std::vector<int>> GeneticBalancer::gga(std::vector<double>& bestFitness, ParetoArchive* archive)
 {
 	///init population
-	auto population = initPopulation(POPULATION_SIZE);
+	int firstGeneration = 0;
+	auto population = resumeFrom ? restoreCheckpoint<Index>(firstGeneration, bestFitness) : initPopulation<Index>(POPULATION_SIZE);
+	if (archive)
+	{
+		archivePopulation(population, *archive);
+		sortPopulationPareto(population);
+	}
 
 	///evolution cycle
-	for (int i = 0; i < MAX_NO_OF_GENERATIONS; ++i)
+	for (int i = firstGeneration; i < MAX_NO_OF_GENERATIONS; ++i)
 	{
+		if (checkpointing && checkpointInterval > 0 && i % checkpointInterval == 0)
+			writeCheckpoint(population, i, bestFitness);
+		if (progress)
+		{
+			publishBest(population, i);
+			if (progress->cancelled)
+				break;
+		}
 		//printPopulation(population, i);
 		//std::cout << "generation " << i << " best fitness: " << population[0].getFitness() << "\n";
-		bestFitness.push_back(population[0].getFitness());
+		if (archive)
+		{
+			///no single best to converge on: the front keeps evolving until the last generation
+			bestFitness.push_back(std::max_element(population.begin(), population.end(), [](const Chromosome<Index>& a, const Chromosome<Index>& b) { return b.isFitter(a); })->getFitness());
+		}
+		else
+			bestFitness.push_back(population[0].getFitness());
 		///check population: if fitness is max -sucess, if diversity is minimal -failure
-		if (population.front().isMaximallyFit() || population.front().getFitness() - population.back().getFitness() < DIVERSITY_THRESHOLD)
+		if (!archive && (population.front().isMaximallyFit() || population.front().getFitness() - population.back().getFitness() < DIVERSITY_THRESHOLD))
 		{
 			//std::cout << "\n[WARNING] BREAK ACCORDING TO DIVERSITY CRITERION\n";
 			break;
@@ -442,11 +1388,13 @@ std::vector<std::vector<int>> GeneticBalancer::gga(std::vector<double>& bestFitn
 		decltype(population) children;
 		for (int parentsCount = 0; parentsCount < int(POPULATION_SIZE*CROSSOVER_RATE) / 2; ++parentsCount)
 		{
-			auto parents = selectParents(population);
+			auto parents = archive ? selectParentsPareto(population) : selectParents(population);
 			children.push_back(crossover(parents.first, parents.second));
 		}
 		for (auto& individual : children)
 			individual.inverse();
+		if (archive)
+			archivePopulation(children, *archive);
 		population.insert(population.end(), children.begin(), children.end());
 
 		///mutations
@@ -454,19 +1402,45 @@ std::vector<std::vector<int>> GeneticBalancer::gga(std::vector<double>& bestFitn
 		for (auto& individual : population)
 			if (randomZeroToOne() < MUTATION_RATE)
 			{
-				Chromosome mutant = individual;
+				Chromosome<Index> mutant = individual;
 				mutant.mutate();
 				mutants.push_back(mutant);
 			}
 		for (auto& individual : mutants)
 			individual.inverse();
+		if (archive)
+			archivePopulation(mutants, *archive);
 		population.insert(population.end(), mutants.begin(), mutants.end());
 
+		///levelling (multi-objective only)
+		if (archive)
+		{
+			decltype(population) levelled;
+			for (auto& individual : population)
+				if (randomZeroToOne() < LEVELLING_RATE)
+				{
+					Chromosome<Index> copy = individual;
+					copy.level(random(0, MAX_OPENED_STATIONS));
+					levelled.push_back(copy);
+				}
+			archivePopulation(levelled, *archive);
+			population.insert(population.end(), levelled.begin(), levelled.end());
+		}
+
 		///prepare for the next generation
-		sortPopulation(population);
+		if (archive)
+			sortPopulationPareto(population);
+		else
+			sortPopulation(population);
 		if (population.size() > POPULATION_SIZE)
 			population.erase(population.begin()+POPULATION_SIZE, population.end());
 	}
+	if (progress)
+		publishBest(population, MAX_NO_OF_GENERATIONS);
+	waitForFlush();
 	//printPopulation(population, -1);
-	return population.front().toBins();
+	seedPopulation.clear();
+	for (auto& individual : population)
+		seedPopulation.push_back(individual.toBins());
+	return seedPopulation.front();
 }
\ No newline at end of file
@@ -1,6 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
 #include <vector>
 
 class GeneticBalancer
@@ -11,64 +18,239 @@ class GeneticBalancer
 	const double			CROSSOVER_RATE = 0.2;
 	const double			MUTATION_RATE = 0.1;
 	const double			MAX_MUTATION_SEVERITY = 0.8;
+	const double			SEED_RATE = 0.5;
+	const double			LEVELLING_RATE = 1.0;
+	const int				MAX_OPENED_STATIONS = 2;
 
-	std::vector<int>		items;
 	int						binCapacity;
+	std::mt19937			rng;
+
+	std::vector<std::vector<std::vector<int>>>	seedPopulation; //final population of the previous gga() run, as bins
 
 public:
 	class PrecedenceGraph
 	{
 		std::vector<std::vector<int>> longestPath;
+		std::vector<std::vector<int>> successors;
 	public:
 		PrecedenceGraph() {};
-		PrecedenceGraph(const std::vector<std::pair<int, int>>& edges);
-		int getMaxDistance(int a, int b) { return longestPath[std::min(a, b)][std::max(a, b)]; };
+		PrecedenceGraph(const std::vector<std::pair<int, int>>& edges, int nodes = 0);
+		int getMaxDistance(int a, int b) const { return longestPath[std::min(a, b)][std::max(a, b)]; };
+		bool sequenceWorkstations(std::vector<std::vector<int>>& workstations, std::vector<std::pair<int, int>>& violations) const;
+		uint64_t hash() const;
+	};
+
+	/**
+	Immutable problem instance, shared between balancers through shared_ptr<const Instance>
+	The precedence graph always covers every task, even those without edges
+	*/
+	class Instance
+	{
+	public:
+		Instance(std::vector<int> items, int binCapacity, const std::vector<std::pair<int, int>>& edges)
+			: items(std::move(items)), binCapacity(binCapacity), precedenceGraph(edges, this->items.size()) {}
+
+		uint64_t						hash() const;
+
+		const std::vector<int>			items;
+		const int						binCapacity;
+		const PrecedenceGraph			precedenceGraph;
+	};
+
+	struct ParetoSolution
+	{
+		int									stations;
+		double								smoothness;
+		std::vector<std::vector<int>>		workstations;
+		std::vector<std::pair<int, int>>	violations;		//precedence edges going backwards, see sequenceWorkstations()
+	};
+
+	/**
+	Non-dominated set of solutions minimising both station count and smoothness index
+	Kept as a staircase: smoothness strictly decreases as the station count grows
+	*/
+	class ParetoArchive
+	{
+		std::map<int, ParetoSolution> front;
+	public:
+		bool							isDominated(int stations, double smoothness) const;
+		void							insert(ParetoSolution solution);
+		std::vector<ParetoSolution>		toVector() const { std::vector<ParetoSolution> result; for (auto& s : front) result.push_back(s.second); return result; }
+	};
+	/**
+	Best solution found so far by a running balanceAsync()
+	*/
+	struct Snapshot
+	{
+		int									generation;
+		double								fitness;
+		std::vector<std::vector<int>>		workstations;
+		std::vector<std::pair<int, int>>	violations;
+	};
+
+private:
+	/**
+	State shared between a running balanceAsync() and its handle
+	Snapshots go through a triple buffer: the evolution cycle fills back and swaps it with middle,
+	the handle swaps middle with front when it is fresh, so neither side ever waits for the other
+	*/
+	struct Progress
+	{
+		static const int		FRESH = 4;
+
+		std::atomic<bool>		cancelled{ false };
+		Snapshot				buffers[3];
+		std::atomic<int>		middle{ 1 };			//buffer index, | FRESH if not read yet
+		int						back = 0;				//evolution cycle only
+		int						front = 2;				//handle only
+		double					publishedFitness = -1;	//evolution cycle only
+		bool					received = false;		//handle only
+
+		void					publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH; }
+	};
+	struct Result
+	{
+		std::vector<std::vector<int>>		workstations;
+		std::vector<double>					bestFitness;
+		long								elapsedTime;
+		std::vector<std::pair<int, int>>	violations;
+	};
+
+public:
+	/**
+	Destroying the handle cancels the run and waits for the generation in progress to end
+	best() must only be called from one thread at a time
+	get() takes the result once; a second get() returns no workstations and isDone() stays true
+	A moved-from handle has no run: best() and get() return nothing, cancel() does nothing, isDone() is true
+	*/
+	class BalanceHandle
+	{
+		std::shared_ptr<Progress>	progress;
+		std::future<Result>			result;
+	public:
+		BalanceHandle(std::shared_ptr<Progress> progress, std::future<Result> result) : progress(std::move(progress)), result(std::move(result)) {}
+		BalanceHandle(BalanceHandle&& other) = default;
+		BalanceHandle& operator=(BalanceHandle&& other);
+		~BalanceHandle();
+
+		bool							best(Snapshot& snapshot);
+		void							cancel() { if (progress) progress->cancelled = true; }
+		bool							isDone() const { return !result.valid() || result.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+		std::vector<std::vector<int>>	get(std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations);
 	};
+
 private:
-	PrecedenceGraph						precedenceGraph;
-	class Chromosome;
-
-	Chromosome							randomChromosome();
-	double								randomZeroToOne();
-	int									random(int min, int max);
-	int									spinRoulette(const std::vector<double>& probabilities);
-	std::vector<Chromosome>				initPopulation(int size);
-	std::pair<Chromosome, Chromosome>	selectParents(const std::vector<Chromosome>& population);
-	std::vector<Chromosome>				selectParents2(const std::vector<Chromosome>& population);
-	void								firstFit(const std::vector<int>& candidates, Chromosome& chromosome);
-	Chromosome							crossover(const Chromosome& parent1, const Chromosome& parent2);
-	void								sortPopulation(std::vector<Chromosome>& population);
-	void								printPopulation(const std::vector<Chromosome>& population, int id);
+	std::shared_ptr<const Instance>		instance;
+	Progress*							progress = nullptr;
+
+	/**
+	Genes store item indexes in the narrowest type that fits the instance (see indexSize())
+	All bins of a chromosome share one array, so a chromosome is two heap blocks whatever its bin count
+	*/
+	template<typename Index> class Chromosome;
+
+	template<typename Index> Chromosome<Index>								randomChromosome();
+	template<typename Index> Chromosome<Index>								seededChromosome(const std::vector<std::vector<int>>& bins);
+	double																	randomZeroToOne();
+	int																		random(int min, int max);
+	int																		spinRoulette(const std::vector<double>& probabilities);
+	template<typename Index> std::vector<Chromosome<Index>>					initPopulation(int size);
+	template<typename Index> std::pair<Chromosome<Index>, Chromosome<Index>>	selectParents(const std::vector<Chromosome<Index>>& population);
+	template<typename Index> std::vector<Chromosome<Index>>					selectParents2(const std::vector<Chromosome<Index>>& population);
+	template<typename Index> void											firstFit(const std::vector<Index>& candidates, Chromosome<Index>& chromosome);
+	template<typename Index> Chromosome<Index>								crossover(const Chromosome<Index>& parent1, const Chromosome<Index>& parent2);
+	template<typename Index> void											sortPopulation(std::vector<Chromosome<Index>>& population);
+	template<typename Index> void											sortPopulationPareto(std::vector<Chromosome<Index>>& population);
+	template<typename Index> std::pair<Chromosome<Index>, Chromosome<Index>>	selectParentsPareto(const std::vector<Chromosome<Index>>& population);
+	template<typename Index> void											printPopulation(const std::vector<Chromosome<Index>>& population, int id);
+	template<typename Index> void											publishBest(const std::vector<Chromosome<Index>>& population, int generation);
 	
+	template<typename Index>
 	class Chromosome
 	{
 				GeneticBalancer&				parent;
-				std::vector<std::vector<int>>	genes;
+				std::vector<Index>				genes;		//items of all bins, bin after bin
+				std::vector<Index>				binEnds;	//end of every bin in genes
 				double							fitness;
+				double							smoothness;
 
 				void							calcFitness();
 
-		friend	Chromosome						GeneticBalancer::randomChromosome();
+				int								binCount() const { return binEnds.size(); }
+				int								binBegin(int i) const { return i ? binEnds[i - 1] : 0; }
+				int								binEnd(int i) const { return binEnds[i]; }
+				int								binSize(int i) const { return binEnd(i) - binBegin(i); }
+				int								binFill(int i) const;
+				template<typename It> void		addBin(It first, It last);
+				void							addToBin(int i, Index item);
+				Index							removeFromBin(int i, int position);
+				void							eraseBins(const std::vector<bool>& erase);
+				void							insertBins(int position, const Chromosome& from, int first, int last);
+				void							reorderBins(const std::vector<int>& order);
+
+		friend	class							GeneticBalancer;
 	public:
 				explicit Chromosome(GeneticBalancer& parent) : parent(parent) {}
 				Chromosome& operator=(const Chromosome& b);
 	public:
 				double							getFitness() const { return fitness; }
+				double							getSmoothness() const { return smoothness; }
+				int								getStations() const { return binCount(); }
 				bool							isFitter(const Chromosome& b) const;
 				bool							isMaximallyFit() const;
-		friend	void							GeneticBalancer::firstFit(const std::vector<int>& candidates, Chromosome& chromosome);
-		friend	Chromosome						GeneticBalancer::crossover(const Chromosome& parent1, const Chromosome& parent2);
 				void							mutate();
 				void							inverse();
+				void							level(int openedStations);
 
 
 				std::string						toString() const;
-				std::vector<std::vector<int>>	toBins();
+				std::vector<std::vector<int>>	toBins() const;
+	};
+
+	/**
+	State of gga() at the start of a generation, enough to continue it bit for bit
+	*/
+	struct Checkpoint
+	{
+		int											generation;
+		std::string									rngState;
+		std::vector<double>							bestFitness;
+		std::vector<std::vector<std::vector<int>>>	genes;
+		std::vector<double>							fitness;
+		std::vector<double>							smoothness;
 	};
 
+	std::string							checkpointFile;
+	int									checkpointInterval = 0;
+	bool								checkpointing = false;	//only balance() checkpoints, see setCheckpoint()
+	std::string							checkpointBuffers[2];	//one is filled while the other is being flushed
+	int									checkpointBuffer = 0;
+	std::future<bool>					pendingFlush;
+	bool								checkpointError = false;
+	std::unique_ptr<Checkpoint>			resumeFrom;
+
+	template<typename Index> void								writeCheckpoint(const std::vector<Chromosome<Index>>& population, int generation, const std::vector<double>& bestFitness);
+	template<typename Index> std::vector<Chromosome<Index>>		restoreCheckpoint(int& generation, std::vector<double>& bestFitness);
+	bool														readCheckpoint(const std::string& file);
+	void														waitForFlush();
+
 private:
-	std::vector<std::vector<int>> gga(std::vector<double>& bestFitness);
+	template<typename Index> void									archivePopulation(const std::vector<Chromosome<Index>>& population, ParetoArchive& archive);
+	template<typename Index> std::vector<std::vector<int>>			gga(std::vector<double>& bestFitness, ParetoArchive* archive);
+	std::vector<std::vector<int>>									solve(std::vector<double>& bestFitness, ParetoArchive* archive);
+	static int														indexSize(size_t itemsCount);
 public:
-	std::vector<std::vector<int>> balance(std::vector<int> items, int binCapacity, const PrecedenceGraph& pg, std::vector<double>& bestFitness, long& elapsedTime);
+	std::vector<std::vector<int>> balance(std::shared_ptr<const Instance> instance, std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations);
+	std::vector<std::vector<int>> balanceCycleTime(std::shared_ptr<const Instance> instance, int stations, std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations, int& cycleTime);
+	static BalanceHandle balanceAsync(std::shared_ptr<const Instance> instance);
+	std::vector<ParetoSolution> balanceMultiObjective(std::shared_ptr<const Instance> instance, std::vector<double>& bestFitness, long& elapsedTime);
+
+	/**
+	Makes balance() write its state every `interval` generations, resume() continues from the file
+	balanceCycleTime() and balanceMultiObjective() do not checkpoint: their probes and archive are not in the file
+	*/
+	void setCheckpoint(const std::string& file, int interval) { checkpointFile = file; checkpointInterval = interval; checkpointError = false; }
+	bool checkpointFailed() const { return checkpointError; }
+	std::vector<std::vector<int>> resume(std::shared_ptr<const Instance> instance, const std::string& file, std::vector<double>& bestFitness, long& elapsedTime, std::vector<std::pair<int, int>>& violations);
 };
 
@@ -0,0 +1,139 @@
+#include "InstanceGenerator.h"
+
+#include <algorithm>
+#include <cstring>
+
+const char InstanceGenerator::BINARY_MAGIC[4] = { 'L', 'B', 'I', '1' };
+
+InstanceGenerator::BinarySink::BinarySink(std::ostream& out) : out(out)
+{
+	out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+}
+
+void InstanceGenerator::BinarySink::write(int32_t x)
+{
+	uint32_t u = x;
+	char bytes[4] = { char(u & 0xFF), char(u >> 8 & 0xFF), char(u >> 16 & 0xFF), char(u >> 24 & 0xFF) };
+	out.write(bytes, sizeof(bytes));
+}
+
+/**
+Replays the task times of every station from the seed
+Called once to count the tasks and once to emit them, so only one station is ever stored
+*/
+template<typename F>
+void InstanceGenerator::forEachStation(F f)
+{
+	itemRng.seed(parameters.seed);
+	int capacity = parameters.binCapacity * (1.0 - parameters.leeway / 100.0);
+	std::vector<int> station;
+	for (int i = 0; i < parameters.stations; ++i)
+	{
+		station.clear();
+		int currentCapacity = capacity;
+		while (currentCapacity > 0)
+		{
+			int curr = random(itemRng, 1, currentCapacity);
+			station.push_back(curr);
+			currentCapacity -= curr;
+		}
+		f(station);
+	}
+}
+
+void InstanceGenerator::generateEdges(int n, Sink& sink, long long& edges)
+{
+	edges = 0;
+	bool lastTaskConnected = false;
+	for (int i = 0; i < n - 1; ++i)
+	{
+		int last = parameters.maxEdgeSpan > 0 ? std::min(n - 1, i + parameters.maxEdgeSpan) : n - 1;
+		int outEdges = std::uniform_real_distribution<double>()(edgeRng) < parameters.secondEdgeRate ? 2 : 1;
+		outEdges = std::min(outEdges, last - i);
+		int first = -1;
+		for (int j = 0; j < outEdges; ++j)
+		{
+			///the second successor is drawn from the range without the first
+			int to = random(edgeRng, i + 1, last - j);
+			if (first != -1 && to >= first)
+				++to;
+			first = to;
+			lastTaskConnected |= to == n - 1;
+			sink.edge(i, to);
+			++edges;
+		}
+	}
+	if (n > 1 && !lastTaskConnected)
+	{
+		sink.edge(n - 2, n - 1);
+		++edges;
+	}
+}
+
+/**
+Shuffles the task times within each station, the stations stay in order so the edges respect them
+*/
+void InstanceGenerator::generateItems(Sink& sink)
+{
+	forEachStation([&](std::vector<int>& station) {
+		std::shuffle(station.begin(), station.end(), edgeRng);
+		for (auto& size : station)
+			sink.item(size);
+	});
+}
+
+void InstanceGenerator::generate(Sink& sink, int& tasks, long long& edges)
+{
+	///1.Count tasks
+	tasks = 0;
+	forEachStation([&tasks](const std::vector<int>& station) { tasks += station.size(); });
+
+	///2.Precedence graph
+	edgeRng.seed(parameters.seed ^ 0x9E3779B97F4A7C15ULL);
+	generateEdges(tasks, sink, edges);
+
+	///3.Bin capacity & task times
+	sink.binCapacity(parameters.binCapacity);
+	generateItems(sink);
+}
+
+/**
+Reads an instance in either the text or the binary format
+*/
+bool InstanceGenerator::read(std::istream& in, std::vector<std::pair<int, int>>& edges, int& binCapacity, std::vector<int>& items)
+{
+	char magic[sizeof(BINARY_MAGIC)] = {};
+	in.read(magic, sizeof(magic));
+	bool binary = in.gcount() == sizeof(magic) && std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+	if (!binary)
+	{
+		in.clear();
+		in.seekg(0);
+	}
+
+	auto next = [&in, binary](int& x) -> bool {
+		if (!binary)
+			return bool(in >> x);
+		unsigned char bytes[4];
+		if (!in.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+			return false;
+		x = int32_t(bytes[0] | bytes[1] << 8 | bytes[2] << 16 | uint32_t(bytes[3]) << 24);
+		return true;
+	};
+
+	while (true)
+	{
+		int a, b;
+		if (!next(a) || !next(b))
+			return false;
+		if (a != -1)
+			edges.push_back({ a, b });
+		else
+		{
+			binCapacity = b;
+			break;
+		}
+	}
+	for (int a; next(a); items.push_back(a));
+	return true;
+}
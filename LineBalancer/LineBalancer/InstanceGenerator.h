@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/**
+Seedable generator of synthetic line balancing instances with a planted station assignment
+
+Every planted station is filled to binCapacity*(1-leeway/100) by splitting it into random task times,
+shuffled within the station, then each task gets one or two successors further down the line
+Tasks are emitted station by station, so every edge stays within a station or goes to a later one
+and the planted stations are a feasible line; with leeway 0 it is also optimal
+The instance is streamed into a Sink: edges first, then the bin capacity, then the task times
+Memory does not depend on the number of tasks, only on the tasks of one station
+*/
+class InstanceGenerator
+{
+public:
+	struct Parameters
+	{
+		uint64_t	seed = 1337;
+		int			binCapacity = 1000;
+		double		leeway = 5;				//percent of every planted station left empty
+		int			stations = 50;			//planted station count, optimal if leeway is 0
+		double		secondEdgeRate = 0.3;	//graph density: probability of a task having two successors
+		int			maxEdgeSpan = 0;		//order strength: successors are at most this many tasks further, 0 - unbounded
+	};
+
+	class Sink
+	{
+	public:
+		virtual ~Sink() {}
+		virtual void edge(int from, int to) = 0;
+		virtual void binCapacity(int capacity) = 0;
+		virtual void item(int size) = 0;
+	};
+
+	/**
+	Same layout as the test files: "u v" lines, "-1 capacity", then space separated task times
+	*/
+	class TextSink : public Sink
+	{
+		std::ostream& out;
+	public:
+		explicit TextSink(std::ostream& out) : out(out) {}
+		void edge(int from, int to) override { out << from << " " << to << "\n"; }
+		void binCapacity(int capacity) override { out << -1 << " " << capacity << "\n"; }
+		void item(int size) override { out << size << " "; }
+	};
+
+	/**
+	BINARY_MAGIC followed by the text layout as little-endian int32 values
+	*/
+	class BinarySink : public Sink
+	{
+		std::ostream& out;
+		void write(int32_t x);
+	public:
+		explicit BinarySink(std::ostream& out);
+		void edge(int from, int to) override { write(from); write(to); }
+		void binCapacity(int capacity) override { write(-1); write(capacity); }
+		void item(int size) override { write(size); }
+	};
+
+	class CollectSink : public Sink
+	{
+	public:
+		std::vector<std::pair<int, int>>	edges;
+		int									capacity = 0;
+		std::vector<int>					items;
+
+		void edge(int from, int to) override { edges.push_back({ from, to }); }
+		void binCapacity(int capacity) override { this->capacity = capacity; }
+		void item(int size) override { items.push_back(size); }
+	};
+
+	static const char BINARY_MAGIC[4];
+
+private:
+	Parameters		parameters;
+	std::mt19937_64	itemRng, edgeRng;
+
+	int				random(std::mt19937_64& rng, int min, int max) { return std::uniform_int_distribution<int>(min, max)(rng); }
+	template<typename F> void forEachStation(F f);
+	void			generateEdges(int n, Sink& sink, long long& edges);
+	void			generateItems(Sink& sink);
+
+public:
+	explicit InstanceGenerator(const Parameters& parameters) : parameters(parameters) {}
+
+	void			generate(Sink& sink, int& tasks, long long& edges);
+
+	static bool		read(std::istream& in, std::vector<std::pair<int, int>>& edges, int& binCapacity, std::vector<int>& items);
+};
@@ -1,4 +1,5 @@
 #include "LineBalancingTester.h"
+#include "InstanceGenerator.h"
 
 #include <algorithm>
 #include <numeric>
@@ -15,7 +16,7 @@ double LineBalancingTester::fitness()
 	{
 		int fill = 0;
 		for (auto& item : gene)
-			fill += items[item];
+			fill += instance->items[item];
 		sum += std::pow(1.0*fill / binCapacity, 2);
 	}
 	return sum / resultPacking.size();
@@ -30,6 +31,8 @@ void LineBalancingTester::displayConsole()
 		for (auto& x : resultPacking[i]) std::cout << x << " ";
 		std::cout << "\n";
 	}
+	for (auto& v : violations)
+		std::cout << "precedence violation: " << v.first << " -> " << v.second << "\n";
 	double result = fitness();
 	std::cout << "Result: " << result << "\n";
 	std::cout << "Best possible: " << result + 0.005 << "\n";
@@ -43,7 +46,7 @@ void LineBalancingTester::displayGraphics()
 	for (int i = 0; i < resultPacking.size(); ++i)
 	{
 		sf::RectangleShape workstationRect;
-		workstationRect.setSize(sf::Vector2f(std::accumulate(resultPacking[i].begin(), resultPacking[i].end(), 0, [this](int soFar, int curr) {return soFar + items[curr]; }),
+		workstationRect.setSize(sf::Vector2f(std::accumulate(resultPacking[i].begin(), resultPacking[i].end(), 0, [this](int soFar, int curr) {return soFar + instance->items[curr]; }),
 											binHeight));
 		workstationRect.setFillColor(orange);
 		workstationRect.setPosition(0, i * (binHeight + binGap));
@@ -124,27 +127,6 @@ void LineBalancingTester::displayGraphics()
 	}
 }
 
-GeneticBalancer::PrecedenceGraph LineBalancingTester::generateAcyclicPrecedenceGraph(int n)
-{
-	std::vector<std::pair<int, int>> g;
-	
-	for (int i = 0; i < n-1; ++i)
-	{
-		int outEdges = (random(0, 99)<70? 1 : 2);
-		for (int j = 0; j < outEdges; ++j)
-			g.push_back({ i, random(i+1, n-1) });
-	}
-	if (std::find_if(g.begin(), g.end(), [n](std::pair<int, int> p) { return p.first==n-1 || p.second==n-1; }) == g.end())
-		g.push_back({ n-2, n-1 });
-
-	/*
-	std::ofstream testFile("c:\\Users\\mickl\\Documents\\Visual Studio 2017\\Projects\\LineBalancer\\Tests\\1.txt");
-	//std::cout << "Precedence graph:\n";
-	for (auto&x : g) testFile << x.first << " " << x.second << "\n";
-	*/
-	return GeneticBalancer::PrecedenceGraph(g);
-}
-
 void LineBalancingTester::test()
 {
 	test(random(300, 1000), random(0, 10)); //2-1000, 0-20
@@ -154,40 +136,38 @@ void LineBalancingTester::test(int binCapacity, double leeway)
 {
 	capacity = binCapacity * (1.0 - leeway/100.0);
 	binsAmount = random(30, 77); //1-100
-	std::vector<int> generatedItems;
-	for (int i = 0; i < binsAmount; ++i)
-	{
-		int currentCapacity = capacity;
-		while (currentCapacity > 0)
-		{
-			int curr = random(1, currentCapacity);
-			generatedItems.push_back(curr);
-			currentCapacity -= curr;
-		}
-	}
-	std::random_shuffle(generatedItems.begin(), generatedItems.end());
+
+	InstanceGenerator::Parameters parameters;
+	parameters.seed = rand();
+	parameters.binCapacity = binCapacity;
+	parameters.leeway = leeway;
+	parameters.stations = binsAmount;
+	InstanceGenerator::CollectSink generated;
+	int tasks;
+	long long edges;
+	InstanceGenerator(parameters).generate(generated, tasks, edges);
 	system("CLS");
 	std::cout << "Bin capacity: " << binCapacity << "\n"
 		<< "Leeway: " << leeway << "\n"
 		<< "Capacity: " << capacity << "\n"
 		<< "Bins Amount: " << binsAmount << "\n";
-	test(generatedItems, binCapacity, generateAcyclicPrecedenceGraph(generatedItems.size()));
+	test(std::make_shared<const GeneticBalancer::Instance>(std::move(generated.items), binCapacity, generated.edges));
 }
 
-void LineBalancingTester::test(std::vector<int> items, int binCapacity, const GeneticBalancer::PrecedenceGraph& pg)
+void LineBalancingTester::test(std::shared_ptr<const GeneticBalancer::Instance> instance)
 {
-	//std::cout << "{"; for (auto&x : items) std::cout << x << ","; std::cout << "} ["<<items.size()<<" items]\n";
-	this->items = items;
-	this->binCapacity = binCapacity;
+	//std::cout << "{"; for (auto&x : instance->items) std::cout << x << ","; std::cout << "} ["<<instance->items.size()<<" items]\n";
+	this->instance = instance;
+	this->binCapacity = instance->binCapacity;
 
 	/*
 	std::ofstream testFile("c:\\Users\\mickl\\Documents\\Visual Studio 2017\\Projects\\LineBalancer\\Tests\\1.txt", std::ios::app);
 	testFile << this->binCapacity << "\n";
-	for (auto& x : items) testFile << x << " ";
+	for (auto& x : instance->items) testFile << x << " ";
 	*/
 
 	long elapsedTime;
-	resultPacking = GeneticBalancer().balance(items, binCapacity, pg, bestFitness, elapsedTime);
+	resultPacking = GeneticBalancer().balance(instance, bestFitness, elapsedTime, violations);
 	
 	displayConsole();
 	std::cout << "Algorithm running time: " << elapsedTime << "ms\n\n\n\n\n\n\n\n";
@@ -208,23 +188,15 @@ void LineBalancingTester::run(int i)
 
 	std::stringstream fileName;
 	fileName << "c:\\Users\\mickl\\Documents\\Visual Studio 2017\\Projects\\LineBalancer\\Tests\\"<<i<<".txt";
-	std::ifstream inFile(fileName.str());
+	std::ifstream inFile(fileName.str(), std::ios::binary);
 
 	//read from file
-	while (true)
+	if (!InstanceGenerator::read(inFile, readPG, readBinCapacity, readItems) || readItems.empty())
 	{
-		int a, b;
-		inFile >> a >> b;
-		if (a != -1)
-			readPG.push_back({ a, b });
-		else
-		{
-			readBinCapacity = b;
-			break;
-		}
+		std::cout << "Cannot read " << fileName.str() << "\n";
+		return;
 	}
-	for (int a; inFile >> a; readItems.push_back(a));
 
 	system("CLS");
-	test(readItems, readBinCapacity, readPG);
+	test(std::make_shared<const GeneticBalancer::Instance>(std::move(readItems), readBinCapacity, readPG));
 }
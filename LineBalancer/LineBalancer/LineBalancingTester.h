@@ -1,25 +1,26 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <memory>
 #include <vector>
 #include "GeneticBalancer.h"
 
 class LineBalancingTester
 {
-	std::vector<int> items;
+	std::shared_ptr<const GeneticBalancer::Instance> instance;
 	int binCapacity, capacity, binsAmount;
 	std::vector<std::vector<int>> resultPacking;
 	std::vector<double> bestFitness;
+	std::vector<std::pair<int, int>> violations;
 
 	int random(int min, int max) { return rand() % (max - min + 1) + min; }
 	double fitness();
 	void displayConsole();
 	void displayGraphics();
 
-	GeneticBalancer::PrecedenceGraph generateAcyclicPrecedenceGraph(int n);
 	void test();
 	void test(int binCapacity, double leeway);
-	void test(std::vector<int> items, int binCapacity, const GeneticBalancer::PrecedenceGraph& pg);
+	void test(std::shared_ptr<const GeneticBalancer::Instance> instance);
 public:
 	void run();
 	void run(int i);